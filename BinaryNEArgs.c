@@ -0,0 +1,24 @@
+// Command line parsing shared by the BinaryNE programs
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "BinaryNEArgs.h"
+
+int ArgPos(char *str, int argc, char **argv)
+{
+    int a;
+    for (a = 1; a < argc; a++)
+    {
+        if (!strcmp(str, argv[a]))
+        {
+            if (a == argc - 1)
+            {
+                printf("Argument missing for %s\n", str);
+                exit(1);
+            }
+            return a;
+        }
+    }
+    return -1;
+}
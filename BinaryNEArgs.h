@@ -0,0 +1,9 @@
+// Command line parsing shared by the BinaryNE programs; not part of the library
+
+#ifndef BINARYNE_ARGS_H
+#define BINARYNE_ARGS_H
+
+// Position of option str in argv, or -1 if absent; exits if the option has no value
+int ArgPos(char *str, int argc, char **argv);
+
+#endif
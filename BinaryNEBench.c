@@ -0,0 +1,179 @@
+// Load generator for the BinaryNE query daemon: measures per request latency percentiles
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "BinaryNELib.h"
+#include "BinaryNEArgs.h"
+#include "BinaryNEQuery.h"
+
+char socket_file[MAX_STRING] = "BinaryNE.sock";
+int num_threads = 4;
+long long num_requests = 10000, batch_size = 16, top_k = 10, warmup = 100, node_num;
+double *latencies;
+long long failures = 0;
+pthread_mutex_t failure_lock = PTHREAD_MUTEX_INITIALIZER;
+
+double Now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int Connect()
+{
+    struct sockaddr_un addr;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socket_file, sizeof(addr.sun_path) - 1);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Send one request for the given node ids and read back the whole reply
+int Query(int fd, uint32_t type, long long query_num, const int64_t *nodes, struct query_reply *reply, struct query_result *results)
+{
+    struct query_request req;
+    req.type = type;
+    req.k = top_k;
+    req.query_num = query_num;
+    req.code_words = 0;
+    if (WriteFull(fd, &req, sizeof(req), -1) != 0) return -1;
+    if (query_num > 0 && WriteFull(fd, nodes, query_num * sizeof(int64_t), -1) != 0) return -1;
+    if (ReadFull(fd, reply, sizeof(*reply), -1) != 0) return -1;
+    if (reply->status != QUERY_OK) return -1;
+    if (reply->query_num > 0 && ReadFull(fd, results, (size_t)reply->query_num * reply->k * sizeof(struct query_result), -1) != 0) return -1;
+    return 0;
+}
+
+void *ClientThread(void *id)
+{
+    long long t = (long long)id, r, q;
+    long long begin = num_requests / num_threads * t;
+    long long end = t == num_threads - 1 ? num_requests : num_requests / num_threads * (t + 1);
+    unsigned long long next_random = t + 1;
+    int64_t *nodes = (int64_t *)malloc(batch_size * sizeof(int64_t));
+    struct query_result *results = (struct query_result *)malloc(batch_size * top_k * sizeof(struct query_result));
+    struct query_reply reply;
+    double t0;
+    int fd = Connect();
+    for (r = begin - warmup; r < end; r++)
+    {
+        for (q = 0; q < batch_size; q++)
+        {
+            next_random = next_random * (unsigned long long)25214903917 + 11;
+            nodes[q] = (next_random >> 16) % node_num;
+        }
+        t0 = Now();
+        if (fd < 0 || Query(fd, QUERY_BY_NODE, batch_size, nodes, &reply, results) != 0)
+        {
+            pthread_mutex_lock(&failure_lock);
+            failures++;
+            pthread_mutex_unlock(&failure_lock);
+            if (r >= begin) latencies[r] = -1;
+            continue;
+        }
+        if (r >= begin) latencies[r] = Now() - t0;
+    }
+    if (fd >= 0) close(fd);
+    free(nodes);
+    free(results);
+    pthread_exit(NULL);
+}
+
+int CompareDouble(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+double Percentile(const double *sorted, long long n, double p)
+{
+    long long i = (long long)(p / 100 * n);
+    if (i >= n) i = n - 1;
+    return sorted[i];
+}
+
+int main(int argc, char **argv)
+{
+    int i;
+    long long a, n;
+    double t0, elapsed;
+    pthread_t *pt;
+    struct query_reply reply;
+    int fd;
+    if ((i = ArgPos((char *)"-socket", argc, argv)) > 0) strcpy(socket_file, argv[i + 1]);
+    if ((i = ArgPos((char *)"-threads", argc, argv)) > 0) num_threads = atoi(argv[i + 1]);
+    if ((i = ArgPos((char *)"-requests", argc, argv)) > 0) num_requests = atoll(argv[i + 1]);
+    if ((i = ArgPos((char *)"-batch", argc, argv)) > 0) batch_size = atoll(argv[i + 1]);
+    if ((i = ArgPos((char *)"-k", argc, argv)) > 0) top_k = atoll(argv[i + 1]);
+    if ((i = ArgPos((char *)"-warmup", argc, argv)) > 0) warmup = atoll(argv[i + 1]);
+    if (argc > 1 && !strcmp(argv[1], "-help"))
+    {
+        printf("---Load generator for the BinaryNE query daemon---\n\n");
+        printf("Options:\n");
+        printf("\t-socket <file>\n");
+        printf("\t\tPath of the daemon socket; default is BinaryNE.sock\n");
+        printf("\t-threads <int>\n");
+        printf("\t\tNumber of concurrent clients, one connection each; default is 4\n");
+        printf("\t-requests <int>\n");
+        printf("\t\tTotal number of timed requests; default is 10000\n");
+        printf("\t-batch <int>\n");
+        printf("\t\tNumber of random query nodes per request; default is 16\n");
+        printf("\t-k <int>\n");
+        printf("\t\tNumber of neighbors per query; default is 10\n");
+        printf("\t-warmup <int>\n");
+        printf("\t\tUntimed requests per client before measuring; default is 100\n");
+        return 0;
+    }
+    if (num_threads < 1 || batch_size < 1 || batch_size > MAX_QUERY_NUM || top_k < 1 || top_k > MAX_QUERY_K || num_requests < num_threads)
+    {
+        printf("ERROR: invalid load parameters\n");
+        return 1;
+    }
+
+    fd = Connect();
+    if (fd < 0 || Query(fd, QUERY_INFO, 0, NULL, &reply, NULL) != 0)
+    {
+        printf("ERROR: cannot reach the daemon on %s\n", socket_file);
+        return 1;
+    }
+    close(fd);
+    node_num = reply.node_num;
+    printf("Daemon serves %lld codes of %u bits\n", node_num, reply.code_bits);
+
+    latencies = (double *)malloc(num_requests * sizeof(double));
+    pt = (pthread_t *)malloc(num_threads * sizeof(pthread_t));
+    t0 = Now();
+    for (a = 0; a < num_threads; a++) pthread_create(&pt[a], NULL, ClientThread, (void *)a);
+    for (a = 0; a < num_threads; a++) pthread_join(pt[a], NULL);
+    elapsed = Now() - t0;
+
+    for (a = 0, n = 0; a < num_requests; a++)
+        if (latencies[a] >= 0) latencies[n++] = latencies[a];
+    if (n == 0)
+    {
+        printf("ERROR: all %lld requests failed\n", num_requests);
+        return 1;
+    }
+    qsort(latencies, n, sizeof(double), CompareDouble);
+    printf("Requests: %lld ok, %lld failed, %d clients, batch %lld, k %lld\n", n, failures, num_threads, batch_size, top_k);
+    printf("Throughput: %.1lf requests/sec, %.1lf queries/sec\n", (n + warmup * num_threads) / elapsed, (n + warmup * num_threads) * batch_size / elapsed);
+    printf("Latency (usec): p50 %.1lf, p90 %.1lf, p99 %.1lf, p99.9 %.1lf, max %.1lf\n",
+           Percentile(latencies, n, 50) * 1e6, Percentile(latencies, n, 90) * 1e6, Percentile(latencies, n, 99) * 1e6,
+           Percentile(latencies, n, 99.9) * 1e6, latencies[n - 1] * 1e6);
+    return 0;
+}
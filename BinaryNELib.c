@@ -0,0 +1,1152 @@
+// Library implementation of BinaryNE; every routine works on an explicit context so that
+// several graphs, corpora and models can live in one process
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "BinaryNELib.h"
+
+static int StartProbe(struct convergence_probe *probe, const struct model *net);
+static void RequestProbe(struct convergence_probe *probe, long long count, double beta);
+static int ProbeStopped(struct convergence_probe *probe);
+static void StopProbe(struct convergence_probe *probe);
+
+// The lookup tables are read-only once built and shared by all models
+static double *sigmoidTable, *tanhTable;
+static pthread_once_t tables_once = PTHREAD_ONCE_INIT;
+
+// Contexts initialized within the same second still get different default seeds
+static unsigned long long seed_count = 0;
+static pthread_mutex_t seed_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void InitSigmoidTable()
+{
+    int i;
+    sigmoidTable = (double *)malloc((SIGMOID_TABLE_SIZE + 1) * sizeof(double));
+    for (i = 0; i < SIGMOID_TABLE_SIZE; i++)
+    {
+        sigmoidTable[i] = exp((i / (double)SIGMOID_TABLE_SIZE * 2 - 1) * SIGMOID_BOUND); // Precompute the exp() table
+        sigmoidTable[i] = sigmoidTable[i] / (sigmoidTable[i] + 1);                   // Precompute f(x) = x / (x + 1)
+    }
+}
+
+double FastSigmoid(double x)
+{
+    double y;
+    if (x > SIGMOID_BOUND)
+        y = 1;
+    else if (x < -SIGMOID_BOUND)
+        y = 0;
+    else
+        y = sigmoidTable[(int)((x + SIGMOID_BOUND) * (SIGMOID_TABLE_SIZE / SIGMOID_BOUND / 2))];
+    return y;
+}
+
+static void InitTanhTable()
+{
+    int i;
+    tanhTable = (double *)malloc((TANH_TABLE_SIZE + 1) * sizeof(double));
+    for (i = 0; i < TANH_TABLE_SIZE; i++)
+        tanhTable[i] = tanh((i / (double)TANH_TABLE_SIZE * 2 - 1) * TANH_BOUND);
+}
+
+double FastTanh(double x)
+{
+    double y;
+    if (x > TANH_BOUND)
+        y = 1;
+    else if (x < -TANH_BOUND)
+        y = -1;
+    else
+        y = tanhTable[(int)((x + TANH_BOUND) * (TANH_TABLE_SIZE / TANH_BOUND / 2))];
+    return y;
+}
+
+static void InitTablesOnce()
+{
+    InitSigmoidTable();
+    InitTanhTable();
+}
+
+// Build the lookup tables once per process, safe to call from concurrent trainers
+void InitTables()
+{
+    pthread_once(&tables_once, InitTablesOnce);
+}
+
+int ReadGraph(struct network *graph, const char *graph_file)
+{
+    FILE *fp;
+    long long i, j, k, l;
+    fp = fopen(graph_file, "r");
+    if (fp == NULL)
+    {
+        printf("ERROR: graph file %s not found!\n", graph_file);
+        return -1;
+    }
+    if (fscanf(fp, "%lld%lld", &graph->node_num, &graph->attribute_num) != 2)
+    {
+        printf("ERROR: graph file %s is malformed!\n", graph_file);
+        fclose(fp);
+        return -1;
+    }
+    graph->node_neighbors = (struct node_neighbor *)calloc(graph->node_num, sizeof(struct node_neighbor));
+    graph->node_contents = (struct node_content *)calloc(graph->node_num, sizeof(struct node_content));
+    for (i = 0; i < graph->node_num; i++)
+    {
+        fscanf(fp, "%lld", &k);
+        graph->node_neighbors[k].node = k;
+        graph->node_contents[k].node = k;
+        fscanf(fp, "%lld", &l);
+        graph->node_neighbors[k].neighbor_size = l;
+        graph->node_neighbors[k].neighbors = (long long *)malloc(l * sizeof(long long));
+        for (j = 0; j < l; j++)
+            fscanf(fp, "%lld", &graph->node_neighbors[k].neighbors[j]);
+        fscanf(fp, "%lld", &l);
+        graph->node_contents[k].content_size = l;
+        graph->node_contents[k].contents = (long long *)malloc(l * sizeof(long long));
+        graph->node_contents[k].freqs = (long long *)malloc(l * sizeof(long long));
+        for (j = 0; j < l; j++)
+            fscanf(fp, "%lld%lld", &graph->node_contents[k].contents[j], &graph->node_contents[k].freqs[j]);
+    }
+    fclose(fp);
+    return 0;
+}
+
+void FreeGraph(struct network *graph)
+{
+    long long i;
+    for (i = 0; i < graph->node_num; i++)
+    {
+        free(graph->node_neighbors[i].neighbors);
+        free(graph->node_contents[i].contents);
+        free(graph->node_contents[i].freqs);
+    }
+    free(graph->node_neighbors);
+    free(graph->node_contents);
+    graph->node_neighbors = NULL;
+    graph->node_contents = NULL;
+    graph->node_num = graph->attribute_num = 0;
+}
+
+static unsigned long long DefaultSeed()
+{
+    unsigned long long count;
+    pthread_mutex_lock(&seed_lock);
+    count = seed_count++;
+    pthread_mutex_unlock(&seed_lock);
+    return (unsigned long long)time(NULL) + count * (unsigned long long)0x9E3779B97F4A7C15;
+}
+
+void InitCorpus(struct walk_corpus *corpus)
+{
+    memset(corpus, 0, sizeof(struct walk_corpus));
+    corpus->window_size = 10;
+    corpus->walk_num = 40;
+    corpus->walk_length = 100;
+    corpus->node_context_hash_size = 1000000000; // Maximum 4G node context pairs
+    corpus->node_attribute_hash_size = 1000000000; // Maximum 4G node attribute pairs
+    corpus->node_context_list_max_size = 1000000;
+    corpus->node_attribute_list_max_size = 1000000;
+    corpus->seed = DefaultSeed();
+}
+
+static long long GetNodeContextHash(const struct walk_corpus *corpus, const struct network *graph, long long node, long long context)
+{
+    long long hash = node * graph->node_num + context;
+    hash = hash % corpus->node_context_hash_size;
+    return hash;
+}
+
+static long long GetNodeAttributeHash(const struct walk_corpus *corpus, const struct network *graph, long long node, long long attribute)
+{
+    long long hash = node * graph->attribute_num + attribute;
+    hash = hash % corpus->node_attribute_hash_size;
+    return hash;
+}
+
+// Returns the position of the pair, -1 if it is absent and -2 if the hash table is full
+static long long SearchNodeContextPair(const struct walk_corpus *corpus, const struct network *graph, long long node, long long context)
+{
+    long long hash = GetNodeContextHash(corpus, graph, node, context);
+    long long hash_iter = 0;
+    long long cur_node, cur_context;
+    while(1)
+    {
+        if (corpus->node_context_hash[hash] == -1) return -1;
+        cur_node = corpus->node_context_list[corpus->node_context_hash[hash]].source;
+        cur_context = corpus->node_context_list[corpus->node_context_hash[hash]].target;
+        if (cur_node == node && cur_context == context) return corpus->node_context_hash[hash];
+        //printf("Hash conflict for node context search!\n");
+        hash = (hash + 1) % corpus->node_context_hash_size;
+        hash_iter++;
+        if (hash_iter >= corpus->node_context_hash_size)
+        {
+            printf("The node context hash table is full!\n");
+            return -2;
+        }
+    }
+    return -1;
+}
+
+//Add node context pair to the node context list
+static long long AddNodeContextToList(struct walk_corpus *corpus, const struct network *graph, long long node, long long context)
+{
+    long long hash;
+    long long hash_iter = 0;
+    corpus->node_context_list[corpus->node_context_list_size].source = node;
+    corpus->node_context_list[corpus->node_context_list_size].target = context;
+    corpus->node_context_list[corpus->node_context_list_size].cn = 1;
+    corpus->node_context_list_size++;
+    if (corpus->node_context_list_size >= corpus->node_context_list_max_size)
+    {
+        corpus->node_context_list_max_size += 100 * graph->node_num;
+        corpus->node_context_list = (struct node_context *)
+                                    realloc(corpus->node_context_list, corpus->node_context_list_max_size * sizeof(struct node_context));
+    }
+    hash = GetNodeContextHash(corpus, graph, node, context);
+    while (corpus->node_context_hash[hash] != -1)
+    {
+        hash = (hash + 1) % corpus->node_context_hash_size;
+        hash_iter++;
+        if (hash_iter >= corpus->node_context_hash_size)
+        {
+            printf("The node context hash table is full!\n");
+            return -2;
+        }
+    }
+    corpus->node_context_hash[hash] = corpus->node_context_list_size - 1;
+    return corpus->node_context_list_size - 1;
+}
+
+//Add node attribute pair to the node attribute list
+static long long AddNodeAttributeToList(struct walk_corpus *corpus, const struct network *graph, long long node, long long attribute, long long cn)
+{
+    long long hash;
+    long long hash_iter = 0;
+    corpus->node_attribute_list[corpus->node_attribute_list_size].node = node;
+    corpus->node_attribute_list[corpus->node_attribute_list_size].attribute = attribute;
+    corpus->node_attribute_list[corpus->node_attribute_list_size].cn = cn;
+    corpus->node_attribute_list_size++;
+    if (corpus->node_attribute_list_size >= corpus->node_attribute_list_max_size)
+    {
+        corpus->node_attribute_list_max_size += 100 * graph->attribute_num;
+        corpus->node_attribute_list = (struct node_attribute *)
+                                      realloc(corpus->node_attribute_list, corpus->node_attribute_list_max_size * sizeof(struct node_attribute));
+    }
+    hash = GetNodeAttributeHash(corpus, graph, node, attribute);
+    while (corpus->node_attribute_hash[hash] != -1)
+    {
+        hash = (hash + 1) % corpus->node_attribute_hash_size;
+        hash_iter++;
+        if (hash_iter >= corpus->node_attribute_hash_size)
+        {
+            printf("The node attribute hash table is full!\n");
+            return -2;
+        }
+    }
+    corpus->node_attribute_hash[hash] = corpus->node_attribute_list_size - 1;
+    return corpus->node_attribute_list_size - 1;
+}
+
+static int CollectNodeAttributePairs(struct walk_corpus *corpus, const struct network *graph)
+{
+    long long j, k;
+    for (k = 0; k < graph->node_num; k++)
+        for (j = 0; j < graph->node_contents[k].content_size; j++)
+        {
+            if (AddNodeAttributeToList(corpus, graph, k, graph->node_contents[k].contents[j], graph->node_contents[k].freqs[j]) < 0)
+                return -1;
+            corpus->attribute_freq[graph->node_contents[k].contents[j]] += graph->node_contents[k].freqs[j];
+        }
+    return 0;
+}
+
+// Count node context pairs within the window along each walk, in both directions
+static int AddWindowPairs(struct walk_corpus *corpus, const struct network *graph, long long node, long long context)
+{
+    long long node_context_pos = SearchNodeContextPair(corpus, graph, node, context);
+    if (node_context_pos == -2) return -1;
+    if (node_context_pos == -1)
+        return AddNodeContextToList(corpus, graph, node, context) < 0 ? -1 : 0;
+    corpus->node_context_list[node_context_pos].cn++;
+    return 0;
+}
+
+static int RandomWalk(struct walk_corpus *corpus, const struct network *graph)
+{
+    long long i, j, k, r;
+    long long cur_node;
+    long long *rand_walk_nodes = (long long *) malloc(corpus->walk_length * sizeof(long long));
+    for (i = 0; i < corpus->walk_num; i++)
+    {
+        for (j = 0; j < graph->node_num; j++)
+        {
+            cur_node = j;
+            corpus->node_freq[cur_node]++;
+            rand_walk_nodes[0] = j;
+            for (k = 1; k < corpus->walk_length; k++)
+            {
+                if(graph->node_neighbors[cur_node].neighbor_size==0)
+                    break;
+                corpus->next_random = corpus->next_random * (unsigned long long)25214903917 + 11;
+                cur_node = graph->node_neighbors[cur_node].neighbors[(corpus->next_random >> 16) % graph->node_neighbors[cur_node].neighbor_size];
+                corpus->node_freq[cur_node]++;
+                rand_walk_nodes[k] = cur_node;
+                for (r = 1; r <= corpus->window_size; r++)
+                {
+                    if (k - r < 0) continue;
+                    if (AddWindowPairs(corpus, graph, rand_walk_nodes[k-r], rand_walk_nodes[k]) < 0 ||
+                        AddWindowPairs(corpus, graph, rand_walk_nodes[k], rand_walk_nodes[k-r]) < 0)
+                    {
+                        free(rand_walk_nodes);
+                        return -1;
+                    }
+                }
+            }
+        }
+    }
+    free(rand_walk_nodes);
+    return 0;
+}
+
+/* The alias sampling algorithm, which is used to sample an node context pair in O(1) time. */
+static void InitNodeContextAliasTable(struct walk_corpus *corpus)
+{
+    long long k;
+    double sum = 0;
+    long long cur_small_block, cur_large_block;
+    long long num_small_block = 0, num_large_block = 0;
+    double *norm_prob;
+    long long *large_block;
+    long long *small_block;
+    corpus->node_context_alias = (long long *)malloc(corpus->node_context_list_size * sizeof(long long));
+    corpus->node_context_prob = (double *)malloc(corpus->node_context_list_size * sizeof(double));
+    norm_prob = (double*)malloc(corpus->node_context_list_size * sizeof(double));
+    large_block = (long long*)malloc(corpus->node_context_list_size * sizeof(long long));
+    small_block = (long long*)malloc(corpus->node_context_list_size * sizeof(long long));
+    for (k = 0; k != corpus->node_context_list_size; k++) sum += corpus->node_context_list[k].cn;
+    for (k = 0; k != corpus->node_context_list_size; k++) norm_prob[k] = corpus->node_context_list[k].cn * corpus->node_context_list_size / sum;
+    for (k = corpus->node_context_list_size - 1; k >= 0; k--)
+    {
+        if (norm_prob[k]<1)
+            small_block[num_small_block++] = k;
+        else
+            large_block[num_large_block++] = k;
+    }
+    while (num_small_block && num_large_block)
+    {
+        cur_small_block = small_block[--num_small_block];
+        cur_large_block = large_block[--num_large_block];
+        corpus->node_context_prob[cur_small_block] = norm_prob[cur_small_block];
+        corpus->node_context_alias[cur_small_block] = cur_large_block;
+        norm_prob[cur_large_block] = norm_prob[cur_large_block] + norm_prob[cur_small_block] - 1;
+        if (norm_prob[cur_large_block] < 1)
+            small_block[num_small_block++] = cur_large_block;
+        else
+            large_block[num_large_block++] = cur_large_block;
+    }
+    while (num_large_block) corpus->node_context_prob[large_block[--num_large_block]] = 1;
+    while (num_small_block) corpus->node_context_prob[small_block[--num_small_block]] = 1;
+    free(norm_prob);
+    free(small_block);
+    free(large_block);
+}
+
+static void InitNodeAttributeAliasTable(struct walk_corpus *corpus)
+{
+    long long k;
+    double sum = 0;
+    long long cur_small_block, cur_large_block;
+    long long num_small_block = 0, num_large_block = 0;
+    double *norm_prob;
+    long long *large_block;
+    long long *small_block;
+    corpus->node_attribute_alias = (long long *)malloc(corpus->node_attribute_list_size * sizeof(long long));
+    corpus->node_attribute_prob = (double *)malloc(corpus->node_attribute_list_size * sizeof(double));
+    norm_prob = (double*)malloc(corpus->node_attribute_list_size * sizeof(double));
+    large_block = (long long*)malloc(corpus->node_attribute_list_size * sizeof(long long));
+    small_block = (long long*)malloc(corpus->node_attribute_list_size * sizeof(long long));
+    for (k = 0; k != corpus->node_attribute_list_size; k++) sum += corpus->node_attribute_list[k].cn;
+    for (k = 0; k != corpus->node_attribute_list_size; k++) norm_prob[k] = corpus->node_attribute_list[k].cn * corpus->node_attribute_list_size / sum;
+    for (k = corpus->node_attribute_list_size - 1; k >= 0; k--)
+    {
+        if (norm_prob[k]<1)
+            small_block[num_small_block++] = k;
+        else
+            large_block[num_large_block++] = k;
+    }
+    while (num_small_block && num_large_block)
+    {
+        cur_small_block = small_block[--num_small_block];
+        cur_large_block = large_block[--num_large_block];
+        corpus->node_attribute_prob[cur_small_block] = norm_prob[cur_small_block];
+        corpus->node_attribute_alias[cur_small_block] = cur_large_block;
+        norm_prob[cur_large_block] = norm_prob[cur_large_block] + norm_prob[cur_small_block] - 1;
+        if (norm_prob[cur_large_block] < 1)
+            small_block[num_small_block++] = cur_large_block;
+        else
+            large_block[num_large_block++] = cur_large_block;
+    }
+    while (num_large_block) corpus->node_attribute_prob[large_block[--num_large_block]] = 1;
+    while (num_small_block) corpus->node_attribute_prob[small_block[--num_small_block]] = 1;
+    free(norm_prob);
+    free(small_block);
+    free(large_block);
+}
+
+// Collect node attribute pairs and node context pairs from the graph, then build the alias tables
+int BuildCorpus(struct walk_corpus *corpus, const struct network *graph)
+{
+    long long i;
+    int status = 0;
+    corpus->next_random = corpus->seed;
+    corpus->node_context_list = (struct node_context *)malloc(corpus->node_context_list_max_size * sizeof(struct node_context));
+    corpus->node_attribute_list = (struct node_attribute *)malloc(corpus->node_attribute_list_max_size * sizeof(struct node_attribute));
+    corpus->node_context_hash = (long long *)malloc(corpus->node_context_hash_size * sizeof(long long));
+    corpus->node_attribute_hash = (long long *)malloc(corpus->node_attribute_hash_size * sizeof(long long));
+    corpus->node_freq = (long long *)calloc(graph->node_num, sizeof(long long));
+    corpus->attribute_freq = (long long *)calloc(graph->attribute_num, sizeof(long long));
+    if (corpus->node_context_list == NULL || corpus->node_attribute_list == NULL ||
+        corpus->node_context_hash == NULL || corpus->node_attribute_hash == NULL ||
+        corpus->node_freq == NULL || corpus->attribute_freq == NULL)
+    {
+        printf("Memory allocation failed for the walk corpus\n");
+        status = -1;
+    }
+    if (status == 0)
+    {
+        for (i = 0; i < corpus->node_context_hash_size; i++) corpus->node_context_hash[i] = -1;
+        for (i = 0; i < corpus->node_attribute_hash_size; i++) corpus->node_attribute_hash[i] = -1;
+        status = CollectNodeAttributePairs(corpus, graph);
+    }
+    if (status == 0) status = RandomWalk(corpus, graph);
+    free(corpus->node_context_hash);
+    free(corpus->node_attribute_hash);
+    corpus->node_context_hash = corpus->node_attribute_hash = NULL;
+    if (status != 0) return status;
+    corpus->node_context_list = (struct node_context *)
+        realloc(corpus->node_context_list, corpus->node_context_list_size * sizeof(struct node_context));
+    corpus->node_attribute_list = (struct node_attribute *)
+        realloc(corpus->node_attribute_list, corpus->node_attribute_list_size * sizeof(struct node_attribute));
+    InitNodeContextAliasTable(corpus);
+    InitNodeAttributeAliasTable(corpus);
+    return 0;
+}
+
+void FreeCorpus(struct walk_corpus *corpus)
+{
+    free(corpus->node_context_list);
+    free(corpus->node_attribute_list);
+    free(corpus->node_context_hash);
+    free(corpus->node_attribute_hash);
+    free(corpus->node_freq);
+    free(corpus->attribute_freq);
+    free(corpus->node_context_alias);
+    free(corpus->node_attribute_alias);
+    free(corpus->node_context_prob);
+    free(corpus->node_attribute_prob);
+    InitCorpus(corpus);
+}
+
+static long long SampleANodeContextPair(const struct walk_corpus *corpus, double rand_value1, double rand_value2)
+{
+    long long k = corpus->node_context_list_size * rand_value1;
+    return rand_value2 < corpus->node_context_prob[k] ? k : corpus->node_context_alias[k];
+}
+
+static long long SampleANodeAttributePair(const struct walk_corpus *corpus, double rand_value1, double rand_value2)
+{
+    long long k = corpus->node_attribute_list_size * rand_value1;
+    return rand_value2 < corpus->node_attribute_prob[k] ? k : corpus->node_attribute_alias[k];
+}
+
+// Uniform number in [0, 1) from the high bits of the per context linear congruential generator
+static double RandomUniform(unsigned long long *next_random)
+{
+    *next_random = *next_random * (unsigned long long)25214903917 + 11;
+    return ((*next_random >> 16) & 0xFFFFFFFF) / 4294967296.0;
+}
+
+void InitModel(struct model *net)
+{
+    memset(net, 0, sizeof(struct model));
+    net->layer1_size = 256;
+    net->negative = 5;
+    net->total_samples = 100000000;
+    net->alpha = 0.025;
+    net->beta = 0.001;
+    net->node_table_size = 1e8;
+    net->attribute_table_size = 1e8;
+    net->seed = DefaultSeed();
+}
+
+static void InitUnigramTable(struct model *net, const struct walk_corpus *corpus)
+{
+    long long a, i;
+    double train_nodes_pow = 0.0, train_attributes_pow = 0.0, d1, power = 0.75;
+    net->node_table = (long long *)malloc(net->node_table_size * sizeof(long long));
+    net->attribute_table = (long long *)malloc(net->attribute_table_size * sizeof(long long));
+    for (a = 0; a < net->node_num; a++) train_nodes_pow += pow(corpus->node_freq[a], power);
+    i = 0;
+    d1 = pow(corpus->node_freq[0], power) / train_nodes_pow;
+    for (a = 0; a < net->node_table_size; a++)
+    {
+        net->node_table[a] = i;
+        if (a / (double)net->node_table_size > d1)
+        {
+            i++;
+            d1 += pow(corpus->node_freq[i], power) / (double)train_nodes_pow;
+        }
+        if (i >= net->node_num) i = net->node_num - 1;
+    }
+    for (a = 0; a < net->attribute_num; a++) train_attributes_pow += pow(corpus->attribute_freq[a], power);
+    i = 0;
+    d1 = pow(corpus->attribute_freq[0], power) / train_attributes_pow;
+    for (a = 0; a < net->attribute_table_size; a++)
+    {
+        net->attribute_table[a] = i;
+        if (a / (double)net->attribute_table_size > d1)
+        {
+            i++;
+            d1 += pow(corpus->attribute_freq[i], power) / (double)train_attributes_pow;
+        }
+        if (i >= net->attribute_num) i = net->attribute_num - 1;
+    }
+}
+
+static int InitNet(struct model *net, const struct network *graph, const struct walk_corpus *corpus)
+{
+    long long a, b;
+    unsigned long long next_random = 1;
+    net->node_num = graph->node_num;
+    net->attribute_num = graph->attribute_num;
+    net->syn0 = (double *)malloc(net->node_num * net->layer1_size * sizeof(double));
+    net->syn1neg_context = (double *)calloc(net->node_num * net->layer1_size, sizeof(double));
+    net->syn1neg_content = (double *)calloc(net->attribute_num * net->layer1_size, sizeof(double));
+    if (net->syn0 == NULL || net->syn1neg_context == NULL || net->syn1neg_content == NULL)
+    {
+        printf("Memory allocation failed for the model\n");
+        return -1;
+    }
+    for (a = 0; a < net->node_num; a++)
+        for (b = 0; b < net->layer1_size; b++)
+        {
+            next_random = next_random * (unsigned long long)25214903917 + 11;
+            net->syn0[a * net->layer1_size + b] = (((next_random & 0xFFFF) / (double)65536) - 0.5) / net->layer1_size;
+        }
+    InitUnigramTable(net, corpus);
+    return 0;
+}
+
+// One negative sampling update of node embedding l1 against output vectors syn1neg
+static void UpdatePair(struct model *net, double *syn1neg, long long l1, long long positive,
+                const long long *table, long long table_size, double *neu1e, unsigned long long *next_random)
+{
+    long long c, d, l2, target, label;
+    long long layer1_size = net->layer1_size;
+    double *syn0 = net->syn0;
+    double f, g;
+    for (c = 0; c < layer1_size; c++) neu1e[c] = 0;
+    for (d = 0; d < net->negative + 1; d++)
+    {
+        if (d == 0)
+        {
+            target = positive;
+            label = 1;
+        }
+        else
+        {
+            *next_random = *next_random * (unsigned long long)25214903917 + 11;
+            target = table[(*next_random >> 16) % table_size];
+            if (target == positive) continue;
+            label = 0;
+        }
+        l2 = target * layer1_size;
+        f = 0;
+        for (c = 0; c < layer1_size; c++)
+            f += FastTanh(syn0[c + l1] * net->beta) * syn1neg[c + l2];
+        f = FastSigmoid(f);
+        g = (label - f) * net->alpha;
+        for (c = 0; c < layer1_size; c++)
+            neu1e[c] += g * syn1neg[c + l2];
+        for (c = 0; c < layer1_size; c++)
+            syn1neg[c + l2] += g * FastTanh(syn0[c + l1] * net->beta);
+    }
+    for (c = 0; c < layer1_size; c++)
+        syn0[c + l1] += neu1e[c] * (1 - FastTanh(syn0[c + l1] * net->beta) * FastTanh(syn0[c + l1] * net->beta)) * net->beta;
+}
+
+int TrainModel(struct model *net, const struct network *graph, const struct walk_corpus *corpus)
+{
+    long long node, context, attribute, cur_pair;
+    long long count = 0, last_count = 0, last_probe_count = 0;
+    unsigned long long next_random = 1;
+    double rand_num0, rand_num1, rand_num2;
+    double *neu1e;
+    struct timespec train_start, train_finish;
+    double train_secs;
+    int probing = 0;
+    InitTables();
+    if (InitNet(net, graph, corpus) != 0) return -1;
+    if (net->probe != NULL && net->probe->interval > 0)
+    {
+        if (StartProbe(net->probe, net) != 0) return -1;
+        probing = 1;
+    }
+    neu1e = (double *)calloc(net->layer1_size, sizeof(double));
+    net->next_random = net->seed;
+    net->starting_alpha = net->alpha;
+    net->beta_step = exp(log(100.0)/((net->total_samples/10001)*0.95));
+    printf("Samples: %lldM\n", net->total_samples / 1000000);
+    printf("Dimension: %lld\n", net->layer1_size);
+    printf("Initial Alpha: %f\n", net->alpha);
+    printf("beta_step: %f\n", net->beta_step);
+
+    clock_gettime(CLOCK_MONOTONIC, &train_start);
+    while (1)
+    {
+        if (count >= net->total_samples) break;
+        if (count - last_count > 10000)
+        {
+            last_count = count;
+            if (probing)
+            {
+                if (ProbeStopped(net->probe)) break;
+                if (count - last_probe_count >= net->probe->interval)
+                {
+                    last_probe_count = count;
+                    RequestProbe(net->probe, count, net->beta);
+                }
+            }
+            printf("Alpha: %f, Beta: %f, Progress %.3lf%%%c", net->alpha, net->beta, (double)count / (double)(net->total_samples + 1) * 100, 13);
+            fflush(stdout);
+            net->alpha = net->starting_alpha * (1 - (double)count / (double)(net->total_samples + 1));
+            net->beta = net->beta * net->beta_step;
+            if (net->alpha < net->starting_alpha * 0.0001) net->alpha = net->starting_alpha * 0.0001;
+            if (net->beta >= 0.1) net->beta = 0.1;
+        }
+        rand_num0 = RandomUniform(&net->next_random);
+        rand_num1 = RandomUniform(&net->next_random);
+        rand_num2 = RandomUniform(&net->next_random);
+        if (rand_num0 <= 0.5)
+        {
+            cur_pair = SampleANodeContextPair(corpus, rand_num1, rand_num2);
+            node = corpus->node_context_list[cur_pair].source;
+            context = corpus->node_context_list[cur_pair].target;
+            UpdatePair(net, net->syn1neg_context, node * net->layer1_size, context,
+                       net->node_table, net->node_table_size, neu1e, &next_random);
+        }
+        else
+        {
+            cur_pair = SampleANodeAttributePair(corpus, rand_num1, rand_num2);
+            node = corpus->node_attribute_list[cur_pair].node;
+            attribute = corpus->node_attribute_list[cur_pair].attribute;
+            UpdatePair(net, net->syn1neg_content, node * net->layer1_size, attribute,
+                       net->attribute_table, net->attribute_table_size, neu1e, &next_random);
+        }
+        count++;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &train_finish);
+    net->trained_samples = count;
+    if (probing)
+    {
+        StopProbe(net->probe);
+        train_secs = (train_finish.tv_sec - train_start.tv_sec) + (train_finish.tv_nsec - train_start.tv_nsec) * 1e-9;
+        if (count < net->total_samples)
+            printf("\nCodes converged at %.2lfM samples, training stopped at %.2lfM of %lldM; saved %.2lfM samples, about %.1lf secs at %.0lf samples/sec\n",
+                   net->probe->stop_count / 1e6, count / 1e6, net->total_samples / 1000000, (net->total_samples - count) / 1e6,
+                   train_secs > 0 ? (net->total_samples - count) * train_secs / count : 0.0,
+                   train_secs > 0 ? count / train_secs : 0.0);
+        else
+            printf("\nCodes did not converge within %lldM samples\n", net->total_samples / 1000000);
+    }
+    free(neu1e);
+    return 0;
+}
+
+void FreeModel(struct model *net)
+{
+    free(net->syn0);
+    free(net->syn1neg_context);
+    free(net->syn1neg_content);
+    free(net->node_table);
+    free(net->attribute_table);
+    net->syn0 = net->syn1neg_context = net->syn1neg_content = NULL;
+    net->node_table = net->attribute_table = NULL;
+}
+
+static int AllocCodeStore(struct code_store *store, long long node_num, long long code_bits)
+{
+    store->node_num = node_num;
+    store->code_bits = code_bits;
+    store->code_words = (code_bits + 63) / 64;
+    store->codes = (uint64_t *)calloc(node_num * store->code_words, sizeof(uint64_t));
+    if (store->codes == NULL)
+    {
+        printf("Memory allocation failed for the code store\n");
+        return -1;
+    }
+    return 0;
+}
+
+// Bit b of a node is 1 when FastTanh(syn0 * beta) >= 0
+static void FillCodeStore(struct code_store *store, const struct model *net, double beta)
+{
+    long long a, b;
+    uint64_t *code;
+    memset(store->codes, 0, store->node_num * store->code_words * sizeof(uint64_t));
+    for (a = 0; a < net->node_num; a++)
+    {
+        code = store->codes + a * store->code_words;
+        for (b = 0; b < net->layer1_size; b++)
+            if (FastTanh(net->syn0[a * net->layer1_size + b] * beta) >= 0.0)
+                code[b >> 6] |= (uint64_t)1 << (b & 63);
+    }
+}
+
+// Extract the binary codes of a trained model
+int BuildCodeStore(struct code_store *store, const struct model *net)
+{
+    InitTables();
+    if (AllocCodeStore(store, net->node_num, net->layer1_size) != 0) return -1;
+    FillCodeStore(store, net, net->beta);
+    return 0;
+}
+
+// Read codes in the format written by WriteCodeStore: one node per line, bits separated by whitespace
+int ReadCodeStore(struct code_store *store, const char *code_file)
+{
+    FILE *fp;
+    long long node_num = 0, code_bits = 0, a, b;
+    int ch, bits_in_line = 0;
+    uint64_t *code;
+    fp = fopen(code_file, "r");
+    if (fp == NULL)
+    {
+        printf("ERROR: code file %s not found!\n", code_file);
+        return -1;
+    }
+    while ((ch = fgetc(fp)) != EOF)
+    {
+        if (ch == '0' || ch == '1') bits_in_line++;
+        else if (ch == '\n' && bits_in_line)
+        {
+            if (node_num == 0) code_bits = bits_in_line;
+            node_num++;
+            bits_in_line = 0;
+        }
+    }
+    if (bits_in_line)
+    {
+        if (node_num == 0) code_bits = bits_in_line;
+        node_num++;
+    }
+    if (node_num == 0)
+    {
+        printf("ERROR: code file %s is empty!\n", code_file);
+        fclose(fp);
+        return -1;
+    }
+    if (AllocCodeStore(store, node_num, code_bits) != 0)
+    {
+        fclose(fp);
+        return -1;
+    }
+    rewind(fp);
+    for (a = 0; a < node_num; a++)
+    {
+        code = store->codes + a * store->code_words;
+        for (b = 0; b < code_bits; )
+        {
+            ch = fgetc(fp);
+            if (ch == EOF || (ch == '\n' && b > 0))
+            {
+                printf("ERROR: node %lld in code file %s has %lld bits, expected %lld\n", a, code_file, b, code_bits);
+                fclose(fp);
+                FreeCodeStore(store);
+                return -1;
+            }
+            if (ch == '1') code[b >> 6] |= (uint64_t)1 << (b & 63);
+            if (ch == '0' || ch == '1') b++;
+        }
+        while ((ch = fgetc(fp)) != EOF && ch != '\n');
+    }
+    fclose(fp);
+    return 0;
+}
+
+int WriteCodeStore(const struct code_store *store, const char *code_file)
+{
+    long long a, b;
+    const uint64_t *code;
+    FILE *fp = fopen(code_file, "w");
+    if (fp == NULL)
+    {
+        printf("ERROR: cannot open %s for writing!\n", code_file);
+        return -1;
+    }
+    for (a = 0; a < store->node_num; a++)
+    {
+        code = store->codes + a * store->code_words;
+        for (b = 0; b < store->code_bits; b++)
+        {
+            fputc((code[b >> 6] >> (b & 63)) & 1 ? '1' : '0', fp);
+            fputc(b < store->code_bits - 1 ? ' ' : '\n', fp);
+        }
+    }
+    fclose(fp);
+    return 0;
+}
+
+void FreeCodeStore(struct code_store *store)
+{
+    free(store->codes);
+    memset(store, 0, sizeof(struct code_store));
+}
+
+long long HammingDistance(const uint64_t *a, const uint64_t *b, long long code_words)
+{
+    long long w, dist = 0;
+    uint64_t x;
+    for (w = 0; w < code_words; w++)
+    {
+        x = a[w] ^ b[w];
+#if defined(__GNUC__)
+        dist += __builtin_popcountll(x);
+#else
+        x = x - ((x >> 1) & 0x5555555555555555ULL);
+        x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+        x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+        dist += (x * 0x0101010101010101ULL) >> 56;
+#endif
+    }
+    return dist;
+}
+
+// Sift the largest (distance, id) entry of a max-heap of size n down from position i
+static void SiftDownHeap(long long *ids, long long *dists, long long n, long long i)
+{
+    long long largest, l, r, t;
+    while (1)
+    {
+        largest = i;
+        l = 2 * i + 1;
+        r = 2 * i + 2;
+        if (l < n && (dists[l] > dists[largest] || (dists[l] == dists[largest] && ids[l] > ids[largest]))) largest = l;
+        if (r < n && (dists[r] > dists[largest] || (dists[r] == dists[largest] && ids[r] > ids[largest]))) largest = r;
+        if (largest == i) break;
+        t = dists[i]; dists[i] = dists[largest]; dists[largest] = t;
+        t = ids[i]; ids[i] = ids[largest]; ids[largest] = t;
+        i = largest;
+    }
+}
+
+/* Exact k nearest neighbors in Hamming distance for a batch of packed query codes.
+   The store is scanned once for the whole batch so every code is fetched from memory once.
+   Results of query q are written to ids/dists[q * k ...] sorted by distance then node id;
+   excludes[q] (if excludes is not NULL) is skipped, and missing results are padded with id -1. */
+void SearchCodeStore(const struct code_store *store, const uint64_t *queries, long long query_num, long long k,
+                     const long long *excludes, long long *ids, long long *dists)
+{
+    long long a, q, n, i, p, t, dist;
+    long long *heap_size, *h_ids, *h_dists;
+    const uint64_t *code;
+    if (k <= 0) return;
+    heap_size = (long long *)calloc(query_num, sizeof(long long));
+    for (a = 0; a < store->node_num; a++)
+    {
+        code = store->codes + a * store->code_words;
+        for (q = 0; q < query_num; q++)
+        {
+            if (excludes != NULL && excludes[q] == a) continue;
+            dist = HammingDistance(queries + q * store->code_words, code, store->code_words);
+            n = heap_size[q];
+            h_ids = ids + q * k;
+            h_dists = dists + q * k;
+            if (n < k)
+            {
+                // Sift up the new entry
+                i = n;
+                h_ids[i] = a;
+                h_dists[i] = dist;
+                while (i > 0)
+                {
+                    p = (i - 1) / 2;
+                    if (h_dists[p] > h_dists[i] || (h_dists[p] == h_dists[i] && h_ids[p] > h_ids[i])) break;
+                    t = h_dists[p]; h_dists[p] = h_dists[i]; h_dists[i] = t;
+                    t = h_ids[p]; h_ids[p] = h_ids[i]; h_ids[i] = t;
+                    i = p;
+                }
+                heap_size[q]++;
+            }
+            else if (dist < h_dists[0])
+            {
+                h_ids[0] = a;
+                h_dists[0] = dist;
+                SiftDownHeap(h_ids, h_dists, k, 0);
+            }
+        }
+    }
+    // Heap sort each result list into ascending order
+    for (q = 0; q < query_num; q++)
+    {
+        h_ids = ids + q * k;
+        h_dists = dists + q * k;
+        for (n = heap_size[q] - 1; n > 0; n--)
+        {
+            t = h_dists[0]; h_dists[0] = h_dists[n]; h_dists[n] = t;
+            t = h_ids[0]; h_ids[0] = h_ids[n]; h_ids[n] = t;
+            SiftDownHeap(h_ids, h_dists, n, 0);
+        }
+        for (n = heap_size[q]; n < k; n++)
+        {
+            h_ids[n] = -1;
+            h_dists[n] = -1;
+        }
+    }
+    free(heap_size);
+}
+
+void InitProbe(struct convergence_probe *probe)
+{
+    memset(probe, 0, sizeof(struct convergence_probe));
+    probe->tolerance = 0.001;
+    probe->patience = 3;
+    probe->min_bits_set = 0.05;
+    probe->auc_tolerance = 0.005;
+}
+
+static int IsNeighbor(const struct network *graph, long long node, long long neighbor)
+{
+    long long j;
+    for (j = 0; j < graph->node_neighbors[node].neighbor_size; j++)
+        if (graph->node_neighbors[node].neighbors[j] == neighbor) return 1;
+    return 0;
+}
+
+static void RemoveNeighbor(struct network *graph, long long node, long long neighbor)
+{
+    long long j;
+    struct node_neighbor *nb = &graph->node_neighbors[node];
+    for (j = 0; j < nb->neighbor_size; j++)
+        if (nb->neighbors[j] == neighbor)
+        {
+            nb->neighbors[j] = nb->neighbors[--nb->neighbor_size];
+            return;
+        }
+}
+
+/* Sample heldout_num unlinked node pairs and remove as many random edges from the graph, keeping
+   every node connected to at least one neighbor; must be called before BuildCorpus. */
+int HoldOutEdges(struct convergence_probe *probe, struct network *graph, long long heldout_num)
+{
+    long long a, n = 0, tries, source, target;
+    unsigned long long next_random = 1;
+    probe->heldout_source = (long long *)malloc(heldout_num * sizeof(long long));
+    probe->heldout_target = (long long *)malloc(heldout_num * sizeof(long long));
+    probe->negative_source = (long long *)malloc(heldout_num * sizeof(long long));
+    probe->negative_target = (long long *)malloc(heldout_num * sizeof(long long));
+    // Negatives are drawn while the graph is complete, so none of them is a held-out edge
+    for (a = 0, tries = 0; a < heldout_num && tries < 100 * heldout_num; tries++)
+    {
+        next_random = next_random * (unsigned long long)25214903917 + 11;
+        source = (next_random >> 16) % graph->node_num;
+        next_random = next_random * (unsigned long long)25214903917 + 11;
+        target = (next_random >> 16) % graph->node_num;
+        if (source == target || IsNeighbor(graph, source, target) || IsNeighbor(graph, target, source)) continue;
+        probe->negative_source[a] = source;
+        probe->negative_target[a] = target;
+        a++;
+    }
+    // Only remove as many edges as there are negatives, so no edge is lost to training unused
+    for (tries = 0; n < a && tries < 100 * heldout_num; tries++)
+    {
+        next_random = next_random * (unsigned long long)25214903917 + 11;
+        source = (next_random >> 16) % graph->node_num;
+        if (graph->node_neighbors[source].neighbor_size < 2) continue;
+        next_random = next_random * (unsigned long long)25214903917 + 11;
+        target = graph->node_neighbors[source].neighbors[(next_random >> 16) % graph->node_neighbors[source].neighbor_size];
+        if (target == source || graph->node_neighbors[target].neighbor_size < 2) continue;
+        RemoveNeighbor(graph, source, target);
+        RemoveNeighbor(graph, target, source);
+        probe->heldout_source[n] = source;
+        probe->heldout_target[n] = target;
+        n++;
+    }
+    // Keep the positive and negative samples the same size
+    probe->heldout_num = n;
+    if (n < heldout_num) printf("Only %lld of %lld edges could be held out\n", n, heldout_num);
+    return n > 0 ? 0 : -1;
+}
+
+// Link prediction AUC of the held-out edges against the unlinked pairs, scored by negative Hamming distance
+static double HeldOutAUC(struct convergence_probe *probe, const struct code_store *store)
+{
+    long long a, d, below = 0;
+    long long *pos_hist = (long long *)calloc(store->code_bits + 1, sizeof(long long));
+    long long *neg_hist = (long long *)calloc(store->code_bits + 1, sizeof(long long));
+    double auc = 0;
+    for (a = 0; a < probe->heldout_num; a++)
+    {
+        pos_hist[HammingDistance(store->codes + probe->heldout_source[a] * store->code_words,
+                                 store->codes + probe->heldout_target[a] * store->code_words, store->code_words)]++;
+        neg_hist[HammingDistance(store->codes + probe->negative_source[a] * store->code_words,
+                                 store->codes + probe->negative_target[a] * store->code_words, store->code_words)]++;
+    }
+    // A positive pair wins against every negative pair with a larger distance and ties count half
+    for (d = store->code_bits; d >= 0; d--)
+    {
+        auc += pos_hist[d] * (below + 0.5 * neg_hist[d]);
+        below += neg_hist[d];
+    }
+    free(pos_hist);
+    free(neg_hist);
+    return auc / ((double)probe->heldout_num * probe->heldout_num);
+}
+
+/* Background probe loop. beta is the copy taken under the lock when the probe was requested;
+   syn0 is read while the trainer keeps updating it, as in Hogwild training, and a value read
+   mid update only perturbs the estimate of one probe. */
+static void *ProbeThread(void *arg)
+{
+    struct convergence_probe *probe = (struct convergence_probe *)arg;
+    struct code_store swap;
+    long long a, flips, ones, count;
+    double beta, bits_set;
+    uint64_t zero[1] = {0};
+    while (1)
+    {
+        pthread_mutex_lock(&probe->lock);
+        while (!probe->requested && !probe->quit) pthread_cond_wait(&probe->cond, &probe->lock);
+        if (probe->quit)
+        {
+            pthread_mutex_unlock(&probe->lock);
+            break;
+        }
+        probe->requested = 0;
+        count = probe->probe_count;
+        beta = probe->probe_beta;
+        pthread_mutex_unlock(&probe->lock);
+
+        FillCodeStore(&probe->cur_codes, probe->net, beta);
+        if (probe->heldout_num > 0)
+        {
+            probe->auc = HeldOutAUC(probe, &probe->cur_codes);
+            if (probe->auc > probe->best_auc) probe->best_auc = probe->auc;
+        }
+        if (probe->probe_num > 0)
+        {
+            flips = ones = 0;
+            for (a = 0; a < probe->cur_codes.node_num * probe->cur_codes.code_words; a++)
+            {
+                flips += HammingDistance(probe->cur_codes.codes + a, probe->last_codes.codes + a, 1);
+                ones += HammingDistance(probe->cur_codes.codes + a, zero, 1);
+            }
+            probe->flip_rate = flips / (double)(probe->cur_codes.node_num * probe->cur_codes.code_bits);
+            bits_set = ones / (double)(probe->cur_codes.node_num * probe->cur_codes.code_bits);
+            // Codes that collapsed towards all 0 or all 1 bits, or lost held-out AUC since its best, are not converged
+            if (probe->flip_rate < probe->tolerance && bits_set >= probe->min_bits_set && bits_set <= 1 - probe->min_bits_set &&
+                (probe->heldout_num == 0 || probe->auc >= probe->best_auc - probe->auc_tolerance))
+                probe->stable_num++;
+            else
+                probe->stable_num = 0;
+            if (probe->heldout_num > 0)
+                printf("\nProbe at %.2lfM samples: %.5lf%% bits flipped, %.2lf%% bits set, held-out AUC %.4lf\n", count / 1e6,
+                       probe->flip_rate * 100, bits_set * 100, probe->auc);
+            else
+                printf("\nProbe at %.2lfM samples: %.5lf%% bits flipped, %.2lf%% bits set\n", count / 1e6,
+                       probe->flip_rate * 100, bits_set * 100);
+            fflush(stdout);
+        }
+        probe->probe_num++;
+        swap = probe->last_codes;
+        probe->last_codes = probe->cur_codes;
+        probe->cur_codes = swap;
+        if (probe->stable_num >= probe->patience)
+        {
+            pthread_mutex_lock(&probe->lock);
+            probe->stop = 1;
+            probe->stop_count = count;
+            pthread_mutex_unlock(&probe->lock);
+        }
+    }
+    return NULL;
+}
+
+static int StartProbe(struct convergence_probe *probe, const struct model *net)
+{
+    probe->net = net;
+    probe->probe_num = probe->stable_num = 0;
+    probe->auc = probe->best_auc = 0;
+    probe->requested = probe->stop = probe->quit = 0;
+    memset(&probe->last_codes, 0, sizeof(struct code_store));
+    memset(&probe->cur_codes, 0, sizeof(struct code_store));
+    if (AllocCodeStore(&probe->last_codes, net->node_num, net->layer1_size) != 0 ||
+        AllocCodeStore(&probe->cur_codes, net->node_num, net->layer1_size) != 0)
+    {
+        FreeCodeStore(&probe->last_codes);
+        FreeCodeStore(&probe->cur_codes);
+        return -1;
+    }
+    pthread_mutex_init(&probe->lock, NULL);
+    pthread_cond_init(&probe->cond, NULL);
+    if (pthread_create(&probe->thread, NULL, ProbeThread, probe) != 0)
+    {
+        printf("Failed to start the convergence probe thread\n");
+        pthread_mutex_destroy(&probe->lock);
+        pthread_cond_destroy(&probe->cond);
+        FreeCodeStore(&probe->last_codes);
+        FreeCodeStore(&probe->cur_codes);
+        return -1;
+    }
+    return 0;
+}
+
+// Hand a probe to the background thread without waiting for it, along with the current beta
+static void RequestProbe(struct convergence_probe *probe, long long count, double beta)
+{
+    pthread_mutex_lock(&probe->lock);
+    if (!probe->stop && !probe->requested)
+    {
+        probe->requested = 1;
+        probe->probe_count = count;
+        probe->probe_beta = beta;
+        pthread_cond_signal(&probe->cond);
+    }
+    pthread_mutex_unlock(&probe->lock);
+}
+
+// Checked by the trainer at every progress step; returns 1 once the codes have converged
+static int ProbeStopped(struct convergence_probe *probe)
+{
+    int stop;
+    pthread_mutex_lock(&probe->lock);
+    stop = probe->stop;
+    pthread_mutex_unlock(&probe->lock);
+    return stop;
+}
+
+static void StopProbe(struct convergence_probe *probe)
+{
+    pthread_mutex_lock(&probe->lock);
+    probe->quit = 1;
+    pthread_cond_signal(&probe->cond);
+    pthread_mutex_unlock(&probe->lock);
+    pthread_join(probe->thread, NULL);
+    pthread_mutex_destroy(&probe->lock);
+    pthread_cond_destroy(&probe->cond);
+    FreeCodeStore(&probe->last_codes);
+    FreeCodeStore(&probe->cur_codes);
+}
+
+void FreeProbe(struct convergence_probe *probe)
+{
+    free(probe->heldout_source);
+    free(probe->heldout_target);
+    free(probe->negative_source);
+    free(probe->negative_target);
+    InitProbe(probe);
+}
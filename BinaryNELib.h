@@ -0,0 +1,142 @@
+// Library interface of BinaryNE: graph loading, walk corpus, trainer and binary code store
+
+#ifndef BINARYNE_LIB_H
+#define BINARYNE_LIB_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+#define MAX_STRING 100
+#define SIGMOID_TABLE_SIZE 1000
+#define TANH_TABLE_SIZE 1000
+#define SIGMOID_BOUND 6
+#define TANH_BOUND 4
+
+struct node_context
+{
+    long long cn;
+    long long source, target;
+};
+
+struct node_attribute
+{
+    long long cn;
+    long long node, attribute;
+};
+
+struct node_neighbor
+{
+    long long node;
+    long long neighbor_size;
+    long long *neighbors;
+};
+
+struct node_content
+{
+    long long node;
+    long long content_size;
+    long long *contents;
+    long long *freqs;
+};
+
+struct network
+{
+    long long node_num;
+    long long attribute_num;
+    struct node_neighbor *node_neighbors;
+    struct node_content *node_contents;
+};
+
+// Node context pairs collected by random walks and node attribute pairs, with their alias tables
+struct walk_corpus
+{
+    long long window_size, walk_num, walk_length;
+    long long node_context_hash_size, node_attribute_hash_size;
+    struct node_context *node_context_list;
+    struct node_attribute *node_attribute_list;
+    long long node_context_list_size, node_context_list_max_size;
+    long long node_attribute_list_size, node_attribute_list_max_size;
+    long long *node_context_hash, *node_attribute_hash;
+    long long *node_freq, *attribute_freq;
+    long long *node_context_alias, *node_attribute_alias;
+    double *node_context_prob, *node_attribute_prob;
+    unsigned long long seed; // Seed of the walks; InitCorpus picks a distinct one per context from the clock
+    unsigned long long next_random;
+};
+
+struct convergence_probe;
+
+// Parameters and parameter matrices of one BinaryNE model
+struct model
+{
+    long long layer1_size, negative, total_samples;
+    double alpha, starting_alpha;
+    double beta, beta_step;
+    double *syn0, *syn1neg_context, *syn1neg_content;
+    long long node_table_size, attribute_table_size;
+    long long *node_table, *attribute_table;
+    long long node_num, attribute_num;
+    long long trained_samples;
+    unsigned long long seed; // Seed of pair sampling; InitModel picks a distinct one per context from the clock
+    unsigned long long next_random;
+    struct convergence_probe *probe;
+};
+
+// Binary codes sign(tanh(syn0 * beta)), packed 64 bits per word
+struct code_store
+{
+    long long node_num;
+    long long code_bits;
+    long long code_words;
+    uint64_t *codes;
+};
+
+/* Periodic probe of code convergence, run on a background thread while TrainModel updates syn0.
+   Every interval samples it measures the fraction of code bits flipped since the previous probe
+   and, with held-out edges, the link prediction AUC of Hamming distance. A probe is stable when
+   the flipped fraction is below tolerance, the fraction of set bits lies within
+   [min_bits_set, 1 - min_bits_set] and the AUC is at most auc_tolerance below the best AUC of
+   all probes so far; training stops after patience consecutive stable probes. */
+struct convergence_probe
+{
+    long long interval, patience, heldout_num;
+    double tolerance, min_bits_set, auc_tolerance;
+    long long *heldout_source, *heldout_target, *negative_source, *negative_target;
+    struct code_store last_codes, cur_codes;
+    const struct model *net;
+    long long probe_num, stable_num, probe_count, stop_count;
+    double probe_beta, flip_rate, auc, best_auc;
+    int requested, stop, quit;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+};
+
+void InitTables();
+double FastSigmoid(double x);
+double FastTanh(double x);
+
+int ReadGraph(struct network *graph, const char *graph_file);
+void FreeGraph(struct network *graph);
+
+void InitCorpus(struct walk_corpus *corpus);
+int BuildCorpus(struct walk_corpus *corpus, const struct network *graph);
+void FreeCorpus(struct walk_corpus *corpus);
+
+void InitModel(struct model *net);
+int TrainModel(struct model *net, const struct network *graph, const struct walk_corpus *corpus);
+void FreeModel(struct model *net);
+
+void InitProbe(struct convergence_probe *probe);
+int HoldOutEdges(struct convergence_probe *probe, struct network *graph, long long heldout_num);
+void FreeProbe(struct convergence_probe *probe);
+
+int BuildCodeStore(struct code_store *store, const struct model *net);
+int ReadCodeStore(struct code_store *store, const char *code_file);
+int WriteCodeStore(const struct code_store *store, const char *code_file);
+void FreeCodeStore(struct code_store *store);
+long long HammingDistance(const uint64_t *a, const uint64_t *b, long long code_words);
+void SearchCodeStore(const struct code_store *store, const uint64_t *queries, long long query_num, long long k,
+                     const long long *excludes, long long *ids, long long *dists);
+
+#endif
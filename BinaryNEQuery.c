@@ -0,0 +1,90 @@
+// Socket I/O helpers shared by the BinaryNE query daemon and its load generator
+
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include "BinaryNEQuery.h"
+
+long long NowMs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+// Wait until fd is ready for events or the deadline passes; a negative deadline waits forever
+static int WaitFd(int fd, short events, long long deadline)
+{
+    struct pollfd p;
+    long long left;
+    int r;
+    p.fd = fd;
+    p.events = events;
+    while (1)
+    {
+        left = -1;
+        if (deadline >= 0)
+        {
+            left = deadline - NowMs();
+            if (left <= 0) return IO_TIMEOUT;
+        }
+        r = poll(&p, 1, (int)left);
+        if (r > 0) return IO_OK;
+        if (r == 0) return IO_TIMEOUT;
+        if (errno != EINTR) return IO_ERROR;
+    }
+}
+
+int ReadFull(int fd, void *buf, size_t len, int timeout_ms)
+{
+    char *p = (char *)buf;
+    long long deadline = timeout_ms < 0 ? -1 : NowMs() + timeout_ms;
+    ssize_t n;
+    int r;
+    while (len > 0)
+    {
+        if (deadline >= 0 && (r = WaitFd(fd, POLLIN, deadline)) != IO_OK) return r;
+        n = read(fd, p, len);
+        if (n == 0) return IO_EOF;
+        if (n < 0)
+        {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                if (deadline < 0 && (r = WaitFd(fd, POLLIN, -1)) != IO_OK) return r;
+                continue;
+            }
+            return IO_ERROR;
+        }
+        p += n;
+        len -= n;
+    }
+    return IO_OK;
+}
+
+int WriteFull(int fd, const void *buf, size_t len, int timeout_ms)
+{
+    const char *p = (const char *)buf;
+    long long deadline = timeout_ms < 0 ? -1 : NowMs() + timeout_ms;
+    ssize_t n;
+    int r;
+    while (len > 0)
+    {
+        if (deadline >= 0 && (r = WaitFd(fd, POLLOUT, deadline)) != IO_OK) return r;
+        n = write(fd, p, len);
+        if (n < 0)
+        {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                if (deadline < 0 && (r = WaitFd(fd, POLLOUT, -1)) != IO_OK) return r;
+                continue;
+            }
+            return IO_ERROR;
+        }
+        p += n;
+        len -= n;
+    }
+    return IO_OK;
+}
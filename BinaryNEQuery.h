@@ -0,0 +1,63 @@
+// Wire format of the BinaryNE query daemon, shared by the daemon and the load generator
+//
+// A client sends a query_request followed by query_num node ids (int64_t) for
+// QUERY_BY_NODE, or query_num * code_words packed codes (uint64_t) for QUERY_BY_CODE.
+// The daemon answers with a query_reply followed by query_num * k query_result entries,
+// the k nearest codes of each query in ascending Hamming distance, padded with node -1.
+// All fields are in host byte order, the socket is a local Unix domain socket.
+
+#ifndef BINARYNE_QUERY_H
+#define BINARYNE_QUERY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define QUERY_INFO 0
+#define QUERY_BY_NODE 1
+#define QUERY_BY_CODE 2
+
+#define QUERY_OK 0
+#define QUERY_BAD_REQUEST 1
+#define QUERY_BAD_NODE 2
+
+#define MAX_QUERY_NUM 4096
+#define MAX_QUERY_K 1024
+
+struct query_request
+{
+    uint32_t type;
+    uint32_t k;
+    uint32_t query_num;
+    uint32_t code_words;
+};
+
+struct query_reply
+{
+    uint32_t status;
+    uint32_t k;
+    uint32_t query_num;
+    uint32_t code_bits;
+    int64_t node_num;
+};
+
+struct query_result
+{
+    int64_t node;
+    int64_t dist;
+};
+
+// Monotonic clock in milliseconds, used for I/O deadlines
+long long NowMs();
+
+#define IO_OK 0
+#define IO_EOF -1
+#define IO_ERROR -2
+#define IO_TIMEOUT -3
+
+// Socket I/O of a whole buffer, retried on EINTR. With timeout_ms >= 0 the whole transfer must
+// finish within timeout_ms milliseconds, otherwise it waits as long as needed.
+// Return IO_OK, or IO_EOF, IO_ERROR or IO_TIMEOUT on failure.
+int ReadFull(int fd, void *buf, size_t len, int timeout_ms);
+int WriteFull(int fd, const void *buf, size_t len, int timeout_ms);
+
+#endif
@@ -1,2 +1,3 @@
+gcc -O2 -pthread BinaryNE.c BinaryNEArgs.c BinaryNELib.c -o BinaryNE -lm || exit 1
 ./BinaryNE -graph cora.txt -output cora_BinaryNE_emb.txt -time cora_BinaryNE_time.txt -size 128 -window 10 -walknum 40 -walklen 100 -samples 100
 ./BinaryNE -graph citeseer.txt -output citeseer_BinaryNE_emb.txt -time citeseer_BinaryNE_time.txt -size 128 -window 10 -walknum 40 -walklen 100 -samples 100
@@ -0,0 +1,435 @@
+// Local query daemon for BinaryNE: keeps binary codes resident and serves batched
+// Hamming k nearest neighbor queries over a Unix domain socket
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "BinaryNELib.h"
+#include "BinaryNEArgs.h"
+#include "BinaryNEQuery.h"
+
+char graph_file[MAX_STRING], code_file[MAX_STRING], emb_file[MAX_STRING], socket_file[MAX_STRING] = "BinaryNE.sock";
+int num_threads = 4, listen_fd = -1;
+long long max_connections = 1024;
+
+// Time a client has to send the rest of a request once it started, and to read the whole reply
+#define IO_TIMEOUT_MS 1000
+
+/* The poller thread owns every connection that is not being served. It reads requests from the
+   non-blocking sockets into a per connection buffer and hands a connection to the ready queue only
+   once a whole request has arrived; a worker answers it and gives the connection back through
+   wake_pipe. Idle and slowly sending clients thus only cost a poll slot and never hold a worker,
+   and a slowly reading client holds one for at most IO_TIMEOUT_MS. */
+struct connection
+{
+    int fd;
+    char *buf;
+    long long size, need, capacity;
+    long long deadline; // When the request being received must be complete, -1 while idle
+};
+
+int wake_pipe[2];
+struct connection **ready_connections;
+long long ready_head = 0, ready_size = 0, open_connections = 0;
+pthread_mutex_t ready_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t ready_cond = PTHREAD_COND_INITIALIZER;
+
+struct network graph;
+struct walk_corpus corpus;
+struct model net;
+struct code_store store;
+
+// Per worker scratch buffers, grown on demand and reused across requests
+struct worker
+{
+    uint64_t *queries;
+    long long *excludes, *ids, *dists;
+    char *output; // A query_reply followed by the query_result entries
+    long long query_capacity, result_capacity;
+};
+
+// Grow the scratch buffers of a worker; on failure the old buffers are kept
+int ReserveWorker(struct worker *w, long long query_num, long long result_num)
+{
+    void *p;
+    if (query_num > w->query_capacity)
+    {
+        if ((p = realloc(w->queries, query_num * store.code_words * sizeof(uint64_t))) == NULL) return -1;
+        w->queries = (uint64_t *)p;
+        if ((p = realloc(w->excludes, query_num * sizeof(long long))) == NULL) return -1;
+        w->excludes = (long long *)p;
+        w->query_capacity = query_num;
+    }
+    if (result_num > w->result_capacity)
+    {
+        if ((p = realloc(w->ids, result_num * sizeof(long long))) == NULL) return -1;
+        w->ids = (long long *)p;
+        if ((p = realloc(w->dists, result_num * sizeof(long long))) == NULL) return -1;
+        w->dists = (long long *)p;
+        if ((p = realloc(w->output, sizeof(struct query_reply) + result_num * sizeof(struct query_result))) == NULL) return -1;
+        w->output = (char *)p;
+        w->result_capacity = result_num;
+    }
+    return 0;
+}
+
+// Number of payload bytes following a request header, or -1 if the header is malformed
+long long RequestPayload(const struct query_request *req)
+{
+    if (req->type == QUERY_INFO) return 0;
+    if ((req->type != QUERY_BY_NODE && req->type != QUERY_BY_CODE) || req->k == 0 || req->k > MAX_QUERY_K ||
+        req->query_num > MAX_QUERY_NUM || (req->type == QUERY_BY_CODE && req->code_words != store.code_words))
+        return -1;
+    if (req->type == QUERY_BY_NODE) return (long long)req->query_num * sizeof(int64_t);
+    return (long long)req->query_num * store.code_words * sizeof(uint64_t);
+}
+
+// Answer the request received on a connection; returns -1 when the connection should be closed
+int ServeRequest(struct connection *c, struct worker *w)
+{
+    struct query_request req;
+    struct query_reply reply;
+    struct query_result *results;
+    const char *payload = c->buf + sizeof(req);
+    long long q, r, result_num;
+    int64_t node;
+    memcpy(&req, c->buf, sizeof(req));
+    memset(&reply, 0, sizeof(reply));
+    reply.code_bits = store.code_bits;
+    reply.node_num = store.node_num;
+    if (req.type == QUERY_INFO) return WriteFull(c->fd, &reply, sizeof(reply), IO_TIMEOUT_MS);
+    if (RequestPayload(&req) < 0)
+    {
+        // The payload length cannot be trusted, so the connection is dropped after the reply
+        reply.status = QUERY_BAD_REQUEST;
+        WriteFull(c->fd, &reply, sizeof(reply), IO_TIMEOUT_MS);
+        return -1;
+    }
+    result_num = (long long)req.query_num * req.k;
+    if (ReserveWorker(w, req.query_num, result_num) != 0) return -1;
+    for (q = 0; q < req.query_num; q++)
+    {
+        if (req.type == QUERY_BY_NODE)
+        {
+            memcpy(&node, payload + q * sizeof(int64_t), sizeof(node));
+            if (node < 0 || node >= store.node_num)
+            {
+                reply.status = QUERY_BAD_NODE;
+                node = 0;
+            }
+            memcpy(w->queries + q * store.code_words, store.codes + node * store.code_words, store.code_words * sizeof(uint64_t));
+            w->excludes[q] = node;
+        }
+        else
+        {
+            memcpy(w->queries + q * store.code_words, payload + q * store.code_words * sizeof(uint64_t), store.code_words * sizeof(uint64_t));
+            w->excludes[q] = -1;
+        }
+    }
+    if (reply.status != QUERY_OK) return WriteFull(c->fd, &reply, sizeof(reply), IO_TIMEOUT_MS);
+    SearchCodeStore(&store, w->queries, req.query_num, req.k, w->excludes, w->ids, w->dists);
+    results = (struct query_result *)(w->output + sizeof(reply));
+    for (r = 0; r < result_num; r++)
+    {
+        results[r].node = w->ids[r];
+        results[r].dist = w->dists[r];
+    }
+    reply.k = req.k;
+    reply.query_num = req.query_num;
+    memcpy(w->output, &reply, sizeof(reply));
+    // One deadline for the whole reply, so a client that reads slowly cannot keep the worker
+    return WriteFull(c->fd, w->output, sizeof(reply) + result_num * sizeof(struct query_result), IO_TIMEOUT_MS);
+}
+
+struct connection *OpenConnection(int fd)
+{
+    struct connection *c = (struct connection *)malloc(sizeof(struct connection));
+    if (c == NULL) return NULL;
+    c->capacity = sizeof(struct query_request);
+    c->buf = (char *)malloc(c->capacity);
+    if (c->buf == NULL)
+    {
+        free(c);
+        return NULL;
+    }
+    c->fd = fd;
+    c->size = 0;
+    c->need = sizeof(struct query_request);
+    c->deadline = -1;
+    return c;
+}
+
+void CloseConnection(struct connection *c)
+{
+    close(c->fd);
+    free(c->buf);
+    free(c);
+    pthread_mutex_lock(&ready_lock);
+    open_connections--;
+    pthread_mutex_unlock(&ready_lock);
+}
+
+/* Read as much of the current request as the socket holds, but nothing past its end, so pipelined
+   requests stay in the socket; returns 1 once the request is complete, 0 while more bytes are
+   needed and -1 when the connection should be closed. A malformed header counts as complete and
+   is rejected by the worker. */
+int ReceiveRequest(struct connection *c)
+{
+    struct query_request req;
+    long long payload;
+    ssize_t n;
+    void *p;
+    while (1)
+    {
+        if (c->size == c->need)
+        {
+            if (c->need > (long long)sizeof(req)) return 1;
+            memcpy(&req, c->buf, sizeof(req));
+            if ((payload = RequestPayload(&req)) <= 0) return 1;
+            c->need = sizeof(req) + payload;
+            if (c->need > c->capacity)
+            {
+                if ((p = realloc(c->buf, c->need)) == NULL) return -1;
+                c->buf = (char *)p;
+                c->capacity = c->need;
+            }
+        }
+        n = read(c->fd, c->buf + c->size, c->need - c->size);
+        if (n == 0) return -1;
+        if (n < 0)
+        {
+            if (errno == EINTR) continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+        }
+        if (c->size == 0) c->deadline = NowMs() + IO_TIMEOUT_MS;
+        c->size += n;
+    }
+}
+
+void *ServeThread(void *id)
+{
+    struct worker w;
+    struct connection *c;
+    (void)id;
+    memset(&w, 0, sizeof(w));
+    while (1)
+    {
+        pthread_mutex_lock(&ready_lock);
+        while (ready_size == 0) pthread_cond_wait(&ready_cond, &ready_lock);
+        c = ready_connections[ready_head];
+        ready_head = (ready_head + 1) % max_connections;
+        ready_size--;
+        pthread_mutex_unlock(&ready_lock);
+        if (ServeRequest(c, &w) == 0)
+        {
+            c->size = 0;
+            c->need = sizeof(struct query_request);
+            c->deadline = -1;
+            WriteFull(wake_pipe[1], &c, sizeof(c), -1);
+        }
+        else CloseConnection(c);
+    }
+    return NULL;
+}
+
+void PollConnections()
+{
+    struct pollfd *fds = (struct pollfd *)malloc((max_connections + 2) * sizeof(struct pollfd));
+    struct connection **conns = (struct connection **)malloc((max_connections + 2) * sizeof(struct connection *));
+    struct connection *c;
+    long long nfds = 2, a, now, next;
+    int fd, r;
+    fds[0].fd = listen_fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = wake_pipe[0];
+    fds[1].events = POLLIN;
+    while (1)
+    {
+        // Wake up in time to drop the first connection whose request is overdue
+        next = -1;
+        for (a = 2; a < nfds; a++)
+            if (conns[a]->deadline >= 0 && (next < 0 || conns[a]->deadline < next)) next = conns[a]->deadline;
+        now = NowMs();
+        if (poll(fds, nfds, next < 0 ? -1 : next > now ? (int)(next - now) : 0) < 0)
+        {
+            if (errno != EINTR) perror("poll");
+            continue;
+        }
+        now = NowMs();
+        // Complete requests go to the workers and leave the poll set until they are handed back
+        for (a = nfds - 1; a >= 2; a--)
+        {
+            c = conns[a];
+            r = fds[a].revents ? ReceiveRequest(c) : 0;
+            if (r == 0 && c->deadline >= 0 && now >= c->deadline) r = -1;
+            if (r == 0) continue;
+            if (r > 0)
+            {
+                pthread_mutex_lock(&ready_lock);
+                ready_connections[(ready_head + ready_size) % max_connections] = c;
+                ready_size++;
+                pthread_cond_signal(&ready_cond);
+                pthread_mutex_unlock(&ready_lock);
+            }
+            else CloseConnection(c);
+            nfds--;
+            fds[a] = fds[nfds];
+            conns[a] = conns[nfds];
+        }
+        if (fds[1].revents)
+            while (read(wake_pipe[0], &c, sizeof(c)) == sizeof(c))
+            {
+                fds[nfds].fd = c->fd;
+                fds[nfds].events = POLLIN;
+                fds[nfds].revents = 0;
+                conns[nfds] = c;
+                nfds++;
+            }
+        if (fds[0].revents)
+            while ((fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK)) >= 0)
+            {
+                // Connections queued, being served or being handed back count against the limit too
+                pthread_mutex_lock(&ready_lock);
+                if (open_connections >= max_connections)
+                {
+                    pthread_mutex_unlock(&ready_lock);
+                    close(fd);
+                    continue;
+                }
+                open_connections++;
+                pthread_mutex_unlock(&ready_lock);
+                if ((c = OpenConnection(fd)) == NULL)
+                {
+                    close(fd);
+                    pthread_mutex_lock(&ready_lock);
+                    open_connections--;
+                    pthread_mutex_unlock(&ready_lock);
+                    continue;
+                }
+                fds[nfds].fd = fd;
+                fds[nfds].events = POLLIN;
+                fds[nfds].revents = 0;
+                conns[nfds] = c;
+                nfds++;
+            }
+    }
+}
+
+int Listen()
+{
+    struct sockaddr_un addr;
+    if (strlen(socket_file) >= sizeof(addr.sun_path))
+    {
+        printf("ERROR: socket path %s is too long!\n", socket_file);
+        return -1;
+    }
+    listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (listen_fd < 0)
+    {
+        perror("socket");
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socket_file);
+    unlink(socket_file);
+    if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(listen_fd, 128) != 0)
+    {
+        perror(socket_file);
+        return -1;
+    }
+    if (pipe(wake_pipe) != 0 || fcntl(wake_pipe[0], F_SETFL, O_NONBLOCK) != 0)
+    {
+        perror("pipe");
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int i;
+    pthread_t *pt;
+    if (argc == 1)
+    {
+        printf("---BinaryNE query daemon: batched Hamming k nearest neighbor search over a Unix socket---\n\n");
+        printf("Options:\n");
+        printf("Codes to serve, either loaded or trained in process:\n");
+        printf("\t-codes <file>\n");
+        printf("\t\tLoad binary codes from <file> written by BinaryNE -output\n");
+        printf("\t-graph <file>\n");
+        printf("\t\tTrain on the input <file> instead; -size, -window, -walknum, -walklen, -negative, -alpha,\n");
+        printf("\t\t-samples and -seed have the same meaning and defaults as for BinaryNE\n");
+        printf("\t-output <file>\n");
+        printf("\t\tUse <file> to save the codes trained in process\n");
+        printf("Parameters for serving:\n");
+        printf("\t-socket <file>\n");
+        printf("\t\tPath of the Unix domain socket to listen on; default is BinaryNE.sock\n");
+        printf("\t-threads <int>\n");
+        printf("\t\tNumber of worker threads serving requests from all connections; default is 4\n");
+        printf("\t-maxconn <int>\n");
+        printf("\t\tMaximum number of open client connections; default is 1024\n");
+        return 0;
+    }
+    InitCorpus(&corpus);
+    InitModel(&net);
+    if ((i = ArgPos((char *)"-codes", argc, argv)) > 0) strcpy(code_file, argv[i + 1]);
+    if ((i = ArgPos((char *)"-graph", argc, argv)) > 0) strcpy(graph_file, argv[i + 1]);
+    if ((i = ArgPos((char *)"-output", argc, argv)) > 0) strcpy(emb_file, argv[i + 1]);
+    if ((i = ArgPos((char *)"-socket", argc, argv)) > 0) strcpy(socket_file, argv[i + 1]);
+    if ((i = ArgPos((char *)"-threads", argc, argv)) > 0) num_threads = atoi(argv[i + 1]);
+    if ((i = ArgPos((char *)"-maxconn", argc, argv)) > 0) max_connections = atoll(argv[i + 1]);
+    if ((i = ArgPos((char *)"-size", argc, argv)) > 0) net.layer1_size = atoi(argv[i + 1]);
+    if ((i = ArgPos((char *)"-alpha", argc, argv)) > 0) net.alpha = atof(argv[i + 1]);
+    if ((i = ArgPos((char *)"-window", argc, argv)) > 0) corpus.window_size = atoi(argv[i + 1]);
+    if ((i = ArgPos((char *)"-walknum", argc, argv)) > 0) corpus.walk_num = atoi(argv[i + 1]);
+    if ((i = ArgPos((char *)"-walklen", argc, argv)) > 0) corpus.walk_length = atoi(argv[i + 1]);
+    if ((i = ArgPos((char *)"-negative", argc, argv)) > 0) net.negative = atoi(argv[i + 1]);
+    if ((i = ArgPos((char *)"-samples", argc, argv)) >0) net.total_samples = atoi(argv[i + 1]) * 1000000LL;
+    if ((i = ArgPos((char *)"-seed", argc, argv)) > 0) corpus.seed = net.seed = strtoull(argv[i + 1], NULL, 10);
+    if (num_threads < 1) num_threads = 1;
+    if (max_connections < num_threads + 1) max_connections = num_threads + 1;
+
+    if (code_file[0] != 0)
+    {
+        if (ReadCodeStore(&store, code_file) != 0) return 1;
+    }
+    else if (graph_file[0] != 0)
+    {
+        if (ReadGraph(&graph, graph_file) != 0) return 1;
+        printf("Training file: %s\n", graph_file);
+        if (BuildCorpus(&corpus, &graph) != 0) return 1;
+        if (TrainModel(&net, &graph, &corpus) != 0) return 1;
+        printf("\n");
+        if (BuildCodeStore(&store, &net) != 0) return 1;
+        FreeModel(&net);
+        FreeCorpus(&corpus);
+        FreeGraph(&graph);
+        if (emb_file[0] != 0 && WriteCodeStore(&store, emb_file) != 0) return 1;
+    }
+    else
+    {
+        printf("ERROR: either -codes or -graph must be given\n");
+        return 1;
+    }
+    printf("Serving %lld codes of %lld bits on %s with %d threads\n", store.node_num, store.code_bits, socket_file, num_threads);
+    fflush(stdout);
+
+    signal(SIGPIPE, SIG_IGN);
+    if (Listen() != 0) return 1;
+    ready_connections = (struct connection **)malloc(max_connections * sizeof(struct connection *));
+    pt = (pthread_t *)malloc(num_threads * sizeof(pthread_t));
+    for (i = 0; i < num_threads; i++) pthread_create(&pt[i], NULL, ServeThread, NULL);
+    PollConnections();
+    return 0;
+}